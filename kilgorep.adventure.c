@@ -7,8 +7,11 @@
  **********************************************************************/
 
 #include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
 #include <string.h>
 #include <dirent.h>
+#include <fcntl.h>
 #include <sys/types.h>
 #include <sys/stat.h>
 #include <unistd.h>
@@ -17,56 +20,143 @@
 
 #define NUM_ROOMS 7
 
+// Longest room name buildrooms will pick; must match kilgorep.buildrooms.c
+#define MAX_NAME_LENGTH 64
+// Size of the user entry buffer: a full room name plus \n and \0
+#define MAX_ENTRY (MAX_NAME_LENGTH + 2)
+
+// Session snapshot files and format identifiers
+#define SAVE_FILE "kilgorep.save"
+#define AUTOSAVE_FILE "kilgorep.autosave"
+#define SNAPSHOT_MAGIC 0x4b505356      // "KPSV"
+#define SNAPSHOT_VERSION 1
+
 typedef enum {false, true} bool;
 typedef enum {START_ROOM, MID_ROOM, END_ROOM} RoomType;
 
+#ifndef EMBEDDED_DUNGEON
+// Interned string table holding every room name
+// Names are stored back to back in one allocation, each ending in \0,
+// and are referred to everywhere else by their offset into it
+struct stringTable
+{
+    char* data;
+    uint32_t size;
+    uint32_t capacity;
+};
+typedef struct stringTable StringTable;
+#endif
+
 struct room
 {
     int id;
-    char name[20];
+    uint32_t name;          // offset of room name in the string table
     int numDoors;
-    struct room* doors[6];
+    const struct room* doors[6];
     RoomType rt;
 };
 typedef struct room Room;
 
+// Everything needed to resume a game in progress
+struct session
+{
+    char dungeonId[256];        // rooms directory the dungeon was built from
+    int location;               // index of the current room
+    int moves;                  // number of steps taken
+    unsigned char* path;        // room index entered on each move
+    int pathCapacity;           // allocated size of path
+};
+typedef struct session Session;
+
+// Fixed size header at the start of a snapshot file. It is followed
+// directly by the path journal, one byte per move, so a snapshot can be
+// restored with a single read and no parsing.
+struct snapshotHeader
+{
+    unsigned int magic;
+    unsigned int version;
+    char dungeonId[256];
+    int location;
+    int moves;
+};
+typedef struct snapshotHeader SnapshotHeader;
+
+// Dungeon tables generated by buildrooms -e, for the embedded build
+#ifdef EMBEDDED_DUNGEON
+#include "kilgorep.dungeon.h"
+#endif
+
 // Function Declarations
-void BuildDungeon(Room dungeon[]);
+#ifdef EMBEDDED_DUNGEON
+void BuildDungeon(const Room dungeon[], char roomsDir[]);
+#else
+void BuildDungeon(Room dungeon[], char roomsDir[]);
 void GetRoomsDirectoryName(char dirName[]);
+uint32_t InternString(StringTable* table, const char* str);
+char* LineValue(char line[]);
 void ParseRoomFile(FILE* fp, Room* roomStruct);
 RoomType GetRoomTypeFromString(char rts[]);
 void ParseRoomConnections(FILE* fp, Room dungeon[], int roomIndex);
-Room* GetRoomPtrFromName(char rName[], Room dungeon[]);
-void PlayGame(Room dungeon[]);
-void ShowUserPrompt(Room dungeon[], Room* location);
-bool GetUserResponse(char uEntry[], Room dungeon[], Room* location);
+#endif
+const char* RoomName(const Room* r);
+const Room* GetRoomPtrFromName(char rName[], const Room dungeon[]);
+void PlayGame(const Room dungeon[], char dungeonId[]);
+void ShowUserPrompt(const Room dungeon[], const Room* location);
+bool GetUserResponse(char uEntry[], const Room dungeon[], const Room* location);
+void InitSession(Session* game, char dungeonId[]);
+void RecordMove(Session* game, int roomIndex);
+void FillSnapshotHeader(Session* game, SnapshotHeader* header);
+bool WriteSnapshot(Session* game, char fileName[]);
+bool ReadSnapshot(Session* game, char fileName[]);
+int OpenAutosave(Session* game);
+int AutosaveMove(int fd, Session* game);
 void* WriteTimeFile();
 
 // Declare mutex
 pthread_mutex_t squirrel;
 
+#ifndef EMBEDDED_DUNGEON
+// Declare table of room names
+StringTable roomNames;
+#endif
+
 // Program main entry point
 int main()
 {
+#ifdef EMBEDDED_DUNGEON
+    // Dungeon layout is compiled in as read-only tables
+    const Room* dungeon = embeddedDungeon;
+#else
     // Declare array of rooms to store dungeon layout
     Room dungeon[NUM_ROOMS];
+#endif
+    char roomsDir[256];     // identifies the dungeon in save files
 
     // Build dungeon
-    BuildDungeon(dungeon);
+    BuildDungeon(dungeon, roomsDir);
 
     // Begin game loop
-    PlayGame(dungeon);
+    PlayGame(dungeon, roomsDir);
 
     return 0;
 }
 
+#ifdef EMBEDDED_DUNGEON
+// Nothing to build, since the dungeon was compiled in from
+// kilgorep.dungeon.h; only the dungeon's id is filled in
+void BuildDungeon(const Room dungeon[], char roomsDir[])
+{
+    (void)dungeon;
+    memset(roomsDir, '\0', 256);
+    strcpy(roomsDir, EMBEDDED_DUNGEON_ID);
+}
+#else
 // Populates the dungeon room array with data from the newest rooms
-// files directory
-void BuildDungeon(Room dungeon[])
+// files directory and stores that directory's name in roomsDir
+void BuildDungeon(Room dungeon[], char roomsDir[])
 {
     // find the newest directory of room files
-    char roomsDir[256];
-    memset(roomsDir, '\0', sizeof(roomsDir));
+    memset(roomsDir, '\0', 256);
     GetRoomsDirectoryName(roomsDir);
 
     // change working directory to selected subdirectory
@@ -143,37 +233,79 @@ void GetRoomsDirectoryName(char dirName[])
     strcpy(dirName, newestDirName);
 }
 
+// Returns the offset of str in the string table, adding it if needed
+uint32_t InternString(StringTable* table, const char* str)
+{
+    uint32_t offset = 0;
+    uint32_t len = strlen(str) + 1;     // add 1 for \0
+
+    // Walk the stored strings looking for a match
+    while (offset < table->size)
+    {
+        if (strcmp(table->data + offset, str) == 0)
+            return offset;
+        offset += strlen(table->data + offset) + 1;
+    }
+
+    // Not found, so grow the table if needed and append it
+    if (table->size + len > table->capacity)
+    {
+        if (table->capacity == 0)
+            table->capacity = 256;
+        while (table->size + len > table->capacity)
+            table->capacity *= 2;
+        table->data = realloc(table->data, table->capacity);
+    }
+    memcpy(table->data + table->size, str, len);
+    table->size += len;
+
+    return offset;
+}
+
+// Returns the text after the ": " in a room file line, with the
+// trailing newline removed
+char* LineValue(char line[])
+{
+    char* value = strstr(line, ": ");
+
+    line[strcspn(line, "\n")] = 0;
+    if (value == NULL)
+        return line + strlen(line);
+    return value + 2;
+}
+
 // Reads a room definition file and assigns name and room type to struct
 // Note: connections will be made in another function
 void ParseRoomFile(FILE* fp, Room* roomStruct)
 {
-    char curLine[80];
-    char roomName[20];
+    char* curLine = NULL;   // grown by getline to fit each whole line
+    size_t lineSize = 0;
     char roomType[20];
     RoomType rType;
 
     // Clear string contents
-    memset(curLine, '\0', sizeof(curLine));
-    memset(roomName, '\0', sizeof(curLine));
-    memset(roomType, '\0', sizeof(curLine));
+    memset(roomType, '\0', sizeof(roomType));
 
-    // Read the room name
-    fgets(curLine, sizeof(curLine), fp);
-    sscanf(curLine, "ROOM NAME: %s\n", roomName);
+    // Read the room name straight into the string table
+    if (getline(&curLine, &lineSize, fp) == -1)
+        roomStruct->name = InternString(&roomNames, "");
+    else
+        roomStruct->name = InternString(&roomNames, LineValue(curLine));
 
-    // Skip through connections
-    while (fgets(curLine, sizeof(curLine), fp))
+    // Skip through connections, then read the room type
+    while (getline(&curLine, &lineSize, fp) != -1)
     {
         if (strstr(curLine, "ROOM TYPE") != NULL)
+        {
+            sscanf(curLine, "ROOM TYPE: %19s\n", roomType);
             break;
+        }
     }
-    // Read the room type
-    sscanf(curLine, "ROOM TYPE: %s\n", roomType);
     rType = GetRoomTypeFromString(roomType);
 
     // Assign values to struct
-    strcpy(roomStruct->name, roomName);
     roomStruct->rt = rType;
+    free(curLine);
 }
 
 // Converts a room type string to the matching enum value
@@ -191,42 +323,53 @@ RoomType GetRoomTypeFromString(char rts[])
 void ParseRoomConnections(FILE* fp, Room dungeon[], int roomIndex)
 {
     int conIndex = 0;
-    char curLine[80];
-    char doorRoom[80];
-    Room* door;
-    memset(curLine, '\0', sizeof(curLine));
-    memset(doorRoom, '\0', sizeof(doorRoom));
+    char* curLine = NULL;   // grown by getline to fit each whole line
+    size_t lineSize = 0;
+    const Room* door;
 
     // Skip name line
-    fgets(curLine, sizeof(curLine), fp);
+    getline(&curLine, &lineSize, fp);
 
     // Loop through connections
     // Does two extra loops for room type line and EOF
-    while (fgets(curLine, sizeof(curLine), fp))
+    while (getline(&curLine, &lineSize, fp) != -1)
     {
         if (strstr(curLine, "CONNECTION") != NULL)
         {
-            // Line describes a room connection, so store the connected room name
-            sscanf(curLine, "CONNECTION %*d: %s\n", doorRoom);
-            // Get a pointer to that room
-            door = GetRoomPtrFromName(doorRoom, dungeon);
+            // Line describes a room connection, so get a pointer to that room
+            door = GetRoomPtrFromName(LineValue(curLine), dungeon);
+            // Skip connections to rooms that don't exist
+            if (door == NULL || conIndex == 6)
+                continue;
             // Build the connection and increment counters
             dungeon[roomIndex].doors[conIndex] = door;
             conIndex++;
             (dungeon[roomIndex].numDoors)++;
         }
     }
+    free(curLine);
+}
+#endif
+
+// Returns the name of a room from the string table
+const char* RoomName(const Room* r)
+{
+#ifdef EMBEDDED_DUNGEON
+    return embeddedNames + r->name;
+#else
+    return roomNames.data + r->name;
+#endif
 }
 
 // Returns a pointer to the dungeon room named rName
-Room* GetRoomPtrFromName(char rName[], Room dungeon[])
+const Room* GetRoomPtrFromName(char rName[], const Room dungeon[])
 {
     int i;
     for (i = 0; i < NUM_ROOMS; i++)
     {
         // Looping through dungeon room structs, is the room name
         // the same as the one we're looking for?
-        if (strcmp(rName, dungeon[i].name) == 0)
+        if (strcmp(rName, RoomName(&(dungeon[i]))) == 0)
         {
             // Return a pointer to the matched room
             return &(dungeon[i]);
@@ -238,24 +381,29 @@ Room* GetRoomPtrFromName(char rName[], Room dungeon[])
 }
 
 // Main loop for execution of the dungeon game
-void PlayGame(Room dungeon[])
+void PlayGame(const Room dungeon[], char dungeonId[])
 {
-    Room* location;
-    Room* destination = NULL;
+    const Room* location;
     bool entrySuccess;
-    FILE* dPath;            // stores names of rooms entered
-    int moves = 0;          // stores number of steps taken
+    Session game;           // current room, move count and path taken
+    int autosaveFd;         // snapshot file updated after every move
+    int i;
     pthread_t timeThread;   // thread for the timekeeping function
     int threadResult;       // stores result of pthread_create
     FILE* timeData;         // time data file created by timekeeping thread
     char timeString[150];   // current time data string
-    char response[200];     // user's action entry string
+    char response[MAX_ENTRY];   // user's action entry string
 
     // Place player in start room, which is always dungeon[0]
-    location = &(dungeon[0]);
+    InitSession(&game, dungeonId);
 
-    // Open file for storing path taken
-    dPath = fopen("path.txt", "w");
+    // Pick up where a crashed or interrupted game left off
+    if (ReadSnapshot(&game, AUTOSAVE_FILE))
+        printf("\nRESUMING YOUR PREVIOUS GAME.\n");
+    location = &(dungeon[game.location]);
+
+    // Start a fresh autosave file for this session
+    autosaveFd = OpenAutosave(&game);
 
     // Lock mutex and kick off the time keeping thread
     pthread_mutex_init(&squirrel, NULL);
@@ -268,113 +416,145 @@ void PlayGame(Room dungeon[])
         ShowUserPrompt(dungeon, location);
 
         // Get response & validate
-        memset(response, '\0', 200);
+        memset(response, '\0', MAX_ENTRY);
         entrySuccess = GetUserResponse(response, dungeon, location);
 
-        // Update location and move count
-        if (entrySuccess)
+        if (!entrySuccess)
+            continue;
+
+        // Save was requested
+        if (strcmp(response, "save") == 0)
         {
-            if (strcmp(response, "time") != 0)
+            if (WriteSnapshot(&game, SAVE_FILE))
+                printf("\nGAME SAVED.\n");
+            else
+                printf("\nUNABLE TO SAVE GAME.\n");
+        }
+        // Load was requested
+        else if (strcmp(response, "load") == 0)
+        {
+            if (ReadSnapshot(&game, SAVE_FILE))
             {
-                location = GetRoomPtrFromName(response, dungeon);
-                fprintf(dPath, "%s\n", response);      // store name in path file
-                moves++;
+                location = &(dungeon[game.location]);
+                if (autosaveFd != -1)
+                    close(autosaveFd);
+                autosaveFd = OpenAutosave(&game);
+                printf("\nGAME LOADED.\n");
             }
-            // Time was requested
             else
-            {
-                // Clear data from previous timeString string
-                memset(timeString, '\0', 150);
-                
-                // Release the squirrel to let the time thread proceed
-                pthread_mutex_unlock(&squirrel);
+                printf("\nNO SAVED GAME FOR THIS DUNGEON.\n");
+        }
+        // Time was requested
+        else if (strcmp(response, "time") == 0)
+        {
+            // Clear data from previous timeString string
+            memset(timeString, '\0', 150);
 
-                // Wait a bit and try mutex lock, block thread until unlocked
-                pthread_mutex_lock(&squirrel);
+            // Release the squirrel to let the time thread proceed
+            pthread_mutex_unlock(&squirrel);
 
-                // Other thread has run and unlocked mutex, so time file is now present
-                // Open it for reading
-                timeData = fopen("currentTime.txt", "r");
+            // Wait a bit and try mutex lock, block thread until unlocked
+            pthread_mutex_lock(&squirrel);
 
-                // Store the file data in the string timeString
-                fgets(timeString, 150, timeData);
-                fclose(timeData);
+            // Other thread has run and unlocked mutex, so time file is now present
+            // Open it for reading
+            timeData = fopen("currentTime.txt", "r");
 
-                // Write the time data to the screen
-                printf("\n%s", timeString);
-            }
+            // Store the file data in the string timeString
+            fgets(timeString, 150, timeData);
+            fclose(timeData);
+
+            // Write the time data to the screen
+            printf("\n%s", timeString);
+        }
+        // Update location and move count
+        else
+        {
+            location = GetRoomPtrFromName(response, dungeon);
+            RecordMove(&game, location->id);
+            autosaveFd = AutosaveMove(autosaveFd, &game);
         }
     }
 
-    fclose(dPath);
+    // Game is over, so the autosave is no longer needed
+    if (autosaveFd != -1)
+        close(autosaveFd);
+    remove(AUTOSAVE_FILE);
 
     // End of dungeon found, so write victory messages
     printf("\nYOU HAVE FOUND THE END ROOM. CONGRATULATIONS!\n");
-    printf("YOU TOOK %d STEPS. YOUR PATH TO VICTORY WAS:\n", moves);
+    printf("YOU TOOK %d STEPS. YOUR PATH TO VICTORY WAS:\n", game.moves);
 
     // Show the path taken
-    // First reopen the path file for reading
-    dPath = fopen("path.txt", "r");
-    char pRoom[20];
-    // Now loop through the file lines
-    while (fgets(pRoom, 20, dPath))
+    for (i = 0; i < game.moves; i++)
     {
-        printf("%s", pRoom);
+        printf("%s\n", RoomName(&(dungeon[game.path[i]])));
     }
-    // Close and delete path file
-    fclose(dPath);
-    remove("path.txt");
+    free(game.path);
 }
 
 // Display a prompt to the user to select a room to travel to
-void ShowUserPrompt(Room dungeon[], Room* location)
+void ShowUserPrompt(const Room dungeon[], const Room* location)
 {
+#ifdef EMBEDDED_DUNGEON
+    // Prompts were built ahead of time by buildrooms
+    fputs(embeddedPrompts[location->id], stdout);
+#else
     // Print line telling current location
-    char locName[20];
-    strcpy(locName, location->name);
-    printf("\nCURRENT LOCATION: %s\n", locName);
+    printf("\nCURRENT LOCATION: %s\n", RoomName(location));
 
     int i;
 
-    // Build connections string
-    char doorString[200];
-    strcpy(doorString, "POSSIBLE CONNECTIONS: ");
+    // Print connections straight from the string table
+    printf("POSSIBLE CONNECTIONS: ");
     for (i = 0; i < location->numDoors; i++)
     {
-        // Add each door name to the string
-        strcat(doorString, location->doors[i]->name);
+        // Print each door name
+        printf("%s", RoomName(location->doors[i]));
 
         // Add appropriate punctuation
         if (i == location->numDoors - 1)
-            strcat(doorString, ".\n");
+            printf(".\n");
         else
-            strcat(doorString,", ");
+            printf(", ");
     }
 
-    // Print connections
-    printf("%s", doorString);
     printf("WHERE TO? >");
+#endif
 }
 
 // Gets response from stdin and validates result
-bool GetUserResponse(char uEntry[], Room dungeon[], Room* location)
+bool GetUserResponse(char uEntry[], const Room dungeon[], const Room* location)
 {
     int i;
+    const Room* target;
 
     // Get user input
 
-        fgets(uEntry, 200, stdin);
+        fgets(uEntry, MAX_ENTRY, stdin);
+
+        // Entry too long to be a room name, so throw away the rest of the
+        // line rather than reading it as the next entry
+        if (strchr(uEntry, '\n') == NULL && strlen(uEntry) == MAX_ENTRY - 1)
+        {
+            while ((i = getchar()) != '\n' && i != EOF)
+                ;
+            printf("\nHUH? I DON'T UNDERSTAND THAT ROOM. TRY AGAIN.\n");
+            return false;
+        }
+
         // Strip trailing \n
         // Taken from https://stackoverflow.com/questions/2693776/removing-trailing-newline-character-from-fgets-input
         uEntry[strcspn(uEntry, "\n")] = 0;
 
         // Check if the name is a valid room
-        if (GetRoomPtrFromName(uEntry, dungeon) != NULL)
+        target = GetRoomPtrFromName(uEntry, dungeon);
+        if (target != NULL)
         {
-            // Check if entered name is connected to location
+            // Check if entered room is connected to location
             for (i = 0; i < location->numDoors; i++)
             {
-                if (strcmp(uEntry, location->doors[i]->name) == 0)
+                if (location->doors[i] == target)
                 {
                     return true;
                 }
@@ -387,11 +567,182 @@ bool GetUserResponse(char uEntry[], Room dungeon[], Room* location)
             return true;
         }
 
+        // Check if user wants to save or restore the game
+        if (strcmp(uEntry, "save") == 0 || strcmp(uEntry, "load") == 0)
+        {
+            return true;
+        }
+
         // Otherwise print error message
         printf("\nHUH? I DON'T UNDERSTAND THAT ROOM. TRY AGAIN.\n");
         return false;
 }
 
+// Starts a new session in the start room of the named dungeon
+void InitSession(Session* game, char dungeonId[])
+{
+    memset(game->dungeonId, '\0', sizeof(game->dungeonId));
+    strncpy(game->dungeonId, dungeonId, sizeof(game->dungeonId) - 1);
+    game->location = 0;
+    game->moves = 0;
+    game->pathCapacity = 32;
+    game->path = malloc(game->pathCapacity);
+}
+
+// Moves the player to a room and appends it to the path journal
+void RecordMove(Session* game, int roomIndex)
+{
+    // Double the journal when it fills up
+    if (game->moves == game->pathCapacity)
+    {
+        game->pathCapacity *= 2;
+        game->path = realloc(game->path, game->pathCapacity);
+    }
+
+    game->path[game->moves] = (unsigned char)roomIndex;
+    game->moves++;
+    game->location = roomIndex;
+}
+
+// Copies the session state into a snapshot file header
+void FillSnapshotHeader(Session* game, SnapshotHeader* header)
+{
+    memset(header, '\0', sizeof(SnapshotHeader));
+    header->magic = SNAPSHOT_MAGIC;
+    header->version = SNAPSHOT_VERSION;
+    memcpy(header->dungeonId, game->dungeonId, sizeof(header->dungeonId));
+    header->location = game->location;
+    header->moves = game->moves;
+}
+
+// Writes a complete snapshot of the session to fileName
+// The snapshot is written to a temp file first and renamed into place
+// so a crash mid-write never leaves a damaged save behind
+bool WriteSnapshot(Session* game, char fileName[])
+{
+    SnapshotHeader header;
+    char tmpName[64];
+    int fd;
+    bool written;
+
+    sprintf(tmpName, "%s.tmp", fileName);
+    fd = open(tmpName, O_WRONLY | O_CREAT | O_TRUNC, 0600);
+    if (fd == -1)
+        return false;
+
+    FillSnapshotHeader(game, &header);
+    written = write(fd, &header, sizeof(header)) == sizeof(header) &&
+        write(fd, game->path, game->moves) == game->moves;
+    close(fd);
+
+    if (!written || rename(tmpName, fileName) != 0)
+    {
+        remove(tmpName);
+        return false;
+    }
+
+    return true;
+}
+
+// Restores the session from the snapshot in fileName
+// Returns false, leaving the session untouched, if the file is missing,
+// damaged, or belongs to a different dungeon
+bool ReadSnapshot(Session* game, char fileName[])
+{
+    struct stat fileAttributes;
+    SnapshotHeader* header;
+    unsigned char* journal;
+    char* buffer;
+    int fd;
+    int i;
+
+    fd = open(fileName, O_RDONLY);
+    if (fd == -1)
+        return false;
+
+    // Pull the whole snapshot in with one read
+    if (fstat(fd, &fileAttributes) != 0 ||
+        fileAttributes.st_size < (off_t)sizeof(SnapshotHeader))
+    {
+        close(fd);
+        return false;
+    }
+    buffer = malloc(fileAttributes.st_size);
+    if (read(fd, buffer, fileAttributes.st_size) != fileAttributes.st_size)
+    {
+        free(buffer);
+        close(fd);
+        return false;
+    }
+    close(fd);
+
+    header = (SnapshotHeader*)buffer;
+    journal = (unsigned char*)(buffer + sizeof(SnapshotHeader));
+
+    // Make sure the snapshot is ours and fits this dungeon
+    bool valid = header->magic == SNAPSHOT_MAGIC &&
+        header->version == SNAPSHOT_VERSION &&
+        strncmp(header->dungeonId, game->dungeonId, sizeof(header->dungeonId)) == 0 &&
+        header->location >= 0 && header->location < NUM_ROOMS &&
+        header->moves >= 0 &&
+        header->moves <= fileAttributes.st_size - (off_t)sizeof(SnapshotHeader);
+    for (i = 0; valid && i < header->moves; i++)
+    {
+        if (journal[i] >= NUM_ROOMS)
+            valid = false;
+    }
+
+    if (valid)
+    {
+        // Grow the journal to hold the saved path if needed
+        if (header->moves > game->pathCapacity)
+        {
+            game->pathCapacity = header->moves;
+            game->path = realloc(game->path, game->pathCapacity);
+        }
+        memcpy(game->path, journal, header->moves);
+        game->moves = header->moves;
+        game->location = header->location;
+    }
+
+    free(buffer);
+    return valid;
+}
+
+// Writes a full snapshot to the autosave file and leaves it open so
+// each later move only has to patch the file in place
+int OpenAutosave(Session* game)
+{
+    if (!WriteSnapshot(game, AUTOSAVE_FILE))
+        return -1;
+
+    return open(AUTOSAVE_FILE, O_WRONLY);
+}
+
+// Brings the autosave file up to date after a move
+// Appends the newest journal entry before rewriting the header, so the
+// header never counts a move that is not yet on disk. If either write
+// fails, the whole snapshot is rewritten instead. Returns the fd to use
+// for the next move, or -1 once autosave has been turned off.
+int AutosaveMove(int fd, Session* game)
+{
+    SnapshotHeader header;
+
+    if (fd == -1)
+        return -1;
+
+    FillSnapshotHeader(game, &header);
+    if (pwrite(fd, &(game->path[game->moves - 1]), 1,
+            sizeof(SnapshotHeader) + game->moves - 1) == 1 &&
+        pwrite(fd, &header, sizeof(header), 0) == sizeof(header))
+    {
+        return fd;
+    }
+
+    close(fd);
+    return OpenAutosave(game);
+}
+
 // Write the current date and time to a text file
 void* WriteTimeFile()
 {
@@ -8,21 +8,49 @@
 #include <stdio.h>
 #include <string.h>
 #include <stdlib.h>
+#include <stdint.h>
+#include <ctype.h>
 #include <time.h>
+#include <fcntl.h>
 #include <sys/types.h>
 #include <unistd.h>
 #include <sys/stat.h>
 #include <dirent.h>
 
 #define NUM_ROOMS 7
+#define EMBED_FILE "kilgorep.dungeon.h"
+
+// Longest room name that can be picked; must match kilgorep.adventure.c
+#define MAX_NAME_LENGTH 64
 
 typedef enum {false, true} bool;
 typedef enum {START_ROOM, MID_ROOM, END_ROOM} RoomType;
 
+// Words adventure reads as commands, so they can't be room names
+static const char* const reservedNames[] = {"time", "save", "load"};
+
+// Built-in room name pool, used when no name file is given
+// Names are stored back to back in a single arena, each ending in \0
+static const char defaultNames[] =
+    "Altuve\0Beltran\0Bregman\0Correa\0Gattis\0"
+    "Gonzalez\0Gurriel\0Keuchel\0Springer\0Verlander";
+
+// Pool of candidate room names
+// All names live in one arena; rooms and the shuffle refer to them by
+// 32-bit offsets into it, so names are never copied
+struct namePool
+{
+    char* arena;            // every name, each ending in \0
+    size_t arenaSize;
+    uint32_t* offsets;      // start of each name in arena
+    uint32_t count;
+};
+typedef struct namePool NamePool;
+
 struct room
 {
     int id;
-    char name[10];
+    uint32_t name;          // offset of room name in the name pool arena
     int numOutboundConnections;
     struct room* outboundConnections[6];
     RoomType rType;
@@ -37,39 +65,69 @@ bool CanAddConnectionFrom(Room* x);
 bool ConnectionAlreadyExists(Room* x, Room* y);
 void ConnectRoom(Room* x, Room* y);
 bool IsSameRoom(Room* x, Room* y);
-void RoomNameListShuffle(char list[][10], size_t n);
-void WriteRoomFiles(Room roomList[], int listSize);
+bool LoadNamePool(NamePool* pool, const char* fileName);
+void IndexNamePool(NamePool* pool);
+uint32_t RandomBelow(uint32_t n);
+bool IsUsableName(const char* name);
+bool PickRoomNames(NamePool* pool, uint32_t picks[], uint32_t numPicks);
+void WriteRoomFiles(Room roomList[], int listSize, NamePool* pool);
+void WriteCString(FILE* fp, const char* str);
+void WriteDungeonHeader(Room roomList[], int listSize, NamePool* pool, char dirName[]);
 char* RoomTypeString(RoomType x);
 
 // Program main entry point
-int main()
+// Usage: buildrooms [-e] [name file]
+// The optional name file lists candidate room names separated by
+// whitespace; without it the built-in pool of 10 names is used
+// With -e, the dungeon is also written out as a C header for the
+// embedded adventure build
+int main(int argc, char* argv[])
 {
+    bool embed = false;
+    const char* nameFile = NULL;
+    int argIndex;
+
     // set random seed using system clock
     srand((unsigned) time(0));
 
-    // 10 room names needed, longest name is 9 characters, add 1 for \0
-    char roomNames[10][10];
-    strcpy(roomNames[0], "Altuve");
-    strcpy(roomNames[1], "Beltran");
-    strcpy(roomNames[2], "Bregman");
-    strcpy(roomNames[3], "Correa");
-    strcpy(roomNames[4], "Gattis");
-    strcpy(roomNames[5], "Gonzalez");
-    strcpy(roomNames[6], "Gurriel");
-    strcpy(roomNames[7], "Keuchel");
-    strcpy(roomNames[8], "Springer");
-    strcpy(roomNames[9], "Verlander");
-
-    // Shuffle the list to get a random set for building rooms
-    RoomNameListShuffle(roomNames, 10);
-
-    // Build array of 7 rooms using first 7 entries in room name list
+    // Check arguments for the embed flag and the name file
+    for (argIndex = 1; argIndex < argc; argIndex++)
+    {
+        if (strcmp(argv[argIndex], "-e") == 0)
+            embed = true;
+        else if (argv[argIndex][0] != '-' && nameFile == NULL)
+            nameFile = argv[argIndex];
+        else
+        {
+            printf("Usage: %s [-e] [name file]\n", argv[0]);
+            return 1;
+        }
+    }
+
+    // Load the room name pool
+    NamePool pool;
+    if (!LoadNamePool(&pool, nameFile))
+    {
+        printf("Failed to load room names.\n");
+        return 1;
+    }
+
+    // Shuffle the pool to get a random set of names for building rooms
+    uint32_t roomNames[NUM_ROOMS];
+    if (!PickRoomNames(&pool, roomNames, NUM_ROOMS))
+    {
+        printf("Need at least %d unique room names of up to %d characters.\n",
+            NUM_ROOMS, MAX_NAME_LENGTH);
+        return 1;
+    }
+
+    // Build array of 7 rooms using the picked names
     Room roomsList[NUM_ROOMS];
     int i;
     for (i = 0; i < NUM_ROOMS; i++)
     {
         roomsList[i].id = i;                        // set id
-        strcpy(roomsList[i].name, roomNames[i]);    // set name
+        roomsList[i].name = roomNames[i];           // set name
         roomsList[i].numOutboundConnections = 0;    // initialize connections cound
 
         // set room 0 to start, room 6 to end, all other mid
@@ -102,11 +160,18 @@ int main()
     chdir(roomDirName);
 
     // Start generating the room files in the directory
-    WriteRoomFiles(roomsList, NUM_ROOMS);
+    WriteRoomFiles(roomsList, NUM_ROOMS, &pool);
 
     // Change back to executable directory
     chdir("..");
 
+    // Generate the embedded dungeon header next to the sources
+    if (embed)
+        WriteDungeonHeader(roomsList, NUM_ROOMS, &pool, roomDirName);
+
+    free(pool.offsets);
+    free(pool.arena);
+
     return 0;
 }
 
@@ -226,30 +291,174 @@ bool IsSameRoom(Room* x, Room* y)
         return false;
 }
 
-/* Shuffles the list of room names into a random ordering
-   Source: https://stackoverflow.com/questions/6127503/shuffle-array-in-c */
-void RoomNameListShuffle(char list[][10], size_t n)
+// Loads candidate room names into the pool's arena
+// With no file name, the built-in names are used. Otherwise the whole
+// file is pulled into the arena in one buffer.
+bool LoadNamePool(NamePool* pool, const char* fileName)
+{
+    struct stat fileAttributes;
+    ssize_t bytesRead;
+    off_t total = 0;
+    int fd;
+
+    memset(pool, 0, sizeof(NamePool));
+
+    if (fileName == NULL)
+    {
+        pool->arenaSize = sizeof(defaultNames);
+        pool->arena = malloc(pool->arenaSize);
+        memcpy(pool->arena, defaultNames, pool->arenaSize);
+    }
+    else
+    {
+        fd = open(fileName, O_RDONLY);
+        if (fd == -1)
+            return false;
+
+        // Offsets are 32 bits, so the arena has to fit in that range
+        if (fstat(fd, &fileAttributes) != 0 ||
+            (uint64_t)fileAttributes.st_size >= UINT32_MAX)
+        {
+            close(fd);
+            return false;
+        }
+
+        // Add 1 for a \0 after the last name
+        pool->arenaSize = fileAttributes.st_size + 1;
+        pool->arena = malloc(pool->arenaSize);
+        // A single read returns at most about 2 GiB, so keep reading
+        // until the whole file has arrived
+        while (total < fileAttributes.st_size)
+        {
+            bytesRead = read(fd, pool->arena + total, fileAttributes.st_size - total);
+            if (bytesRead <= 0)
+            {
+                free(pool->arena);
+                close(fd);
+                return false;
+            }
+            total += bytesRead;
+        }
+        pool->arena[fileAttributes.st_size] = '\0';
+        close(fd);
+    }
+
+    IndexNamePool(pool);
+    return true;
+}
+
+// Splits the arena into names in place and records where each one starts
+// Whitespace and \0 both separate names, since room files can't hold
+// names containing spaces
+void IndexNamePool(NamePool* pool)
+{
+    size_t i;
+    uint32_t n = 0;
+    bool inName = false;
+
+    // First pass terminates each name and counts them
+    for (i = 0; i < pool->arenaSize; i++)
+    {
+        if (pool->arena[i] == '\0' || isspace((unsigned char)pool->arena[i]))
+        {
+            pool->arena[i] = '\0';
+            inName = false;
+        }
+        else if (!inName)
+        {
+            inName = true;
+            n++;
+        }
+    }
+
+    // Second pass records the offset of each name
+    pool->offsets = malloc(n * sizeof(uint32_t));
+    pool->count = 0;
+    for (i = 0; i < pool->arenaSize; i++)
+    {
+        if (pool->arena[i] != '\0' && (i == 0 || pool->arena[i - 1] == '\0'))
+        {
+            pool->offsets[pool->count] = (uint32_t)i;
+            pool->count++;
+        }
+    }
+}
+
+// Returns a random number in the range 0 to n - 1
+// Two rand() calls are combined when n is larger than RAND_MAX
+uint32_t RandomBelow(uint32_t n)
 {
-    if (n > 1)
+    uint64_t r = (uint64_t)rand();
+
+    if (n > RAND_MAX)
+        r = r * ((uint64_t)RAND_MAX + 1) + (uint64_t)rand();
+
+    return (uint32_t)(r % n);
+}
+
+// Check that a name fits adventure's entry buffer and isn't a command
+bool IsUsableName(const char* name)
+{
+    size_t i;
+
+    if (strlen(name) > MAX_NAME_LENGTH)
+        return false;
+
+    for (i = 0; i < sizeof(reservedNames) / sizeof(reservedNames[0]); i++)
     {
-        size_t i;
+        if (strcmp(name, reservedNames[i]) == 0)
+            return false;
+    }
 
-        // Loop forward through elements of list array
-        for (i = 0; i < n-1; i++)
+    return true;
+}
+
+/* Picks numPicks unique room names at random from the pool
+   Only the 32-bit name offsets are shuffled, and the shuffle stops as
+   soon as enough names are found, so large pools cost no more than
+   small ones. Based on the Fisher-Yates shuffle from
+   https://stackoverflow.com/questions/6127503/shuffle-array-in-c */
+bool PickRoomNames(NamePool* pool, uint32_t picks[], uint32_t numPicks)
+{
+    uint32_t picked = 0;
+    uint32_t i;
+    uint32_t j;
+    uint32_t k;
+    uint32_t tmp;
+    bool duplicate;
+
+    // Loop forward through elements of offsets array
+    for (i = 0; i < pool->count && picked < numPicks; i++)
+    {
+        // Choose a random element at or after the ith element
+        j = i + RandomBelow(pool->count - i);
+        // Swap elements i and j
+        tmp = pool->offsets[j];
+        pool->offsets[j] = pool->offsets[i];
+        pool->offsets[i] = tmp;
+
+        // Skip names that are unusable or repeat one already picked
+        duplicate = !IsUsableName(pool->arena + tmp);
+        for (k = 0; k < picked && !duplicate; k++)
         {
-            // Choose a random element after the ith element
-            size_t j = i + rand() / (RAND_MAX / (n - i) + 1);
-            char tmp[10];
-            // Swap elements i and j
-            strcpy(tmp, list[j]);
-            strcpy(list[j], list[i]);
-            strcpy(list[i], tmp);
+            if (strcmp(pool->arena + picks[k], pool->arena + tmp) == 0)
+            {
+                duplicate = true;
+                break;
+            }
+        }
+        if (!duplicate)
+        {
+            picks[picked] = tmp;
+            picked++;
         }
     }
+
+    return picked == numPicks;
 }
 
 // Write all the room descriptions to individual files
-void WriteRoomFiles(Room roomList[], int listSize)
+void WriteRoomFiles(Room roomList[], int listSize, NamePool* pool)
 {
     FILE* fp;
     const char * const fileNames[] = {"room0", "room1", "room2", "room3",
@@ -263,12 +472,13 @@ void WriteRoomFiles(Room roomList[], int listSize)
         // Open ith output file
         fp = fopen(fileNames[i], "w");
         // Write room name to file
-        fprintf(fp, "ROOM NAME: %s\n", roomList[i].name);
+        fprintf(fp, "ROOM NAME: %s\n", pool->arena + roomList[i].name);
 
         // Loop through writing connections
         for (j = 0; j < roomList[i].numOutboundConnections; j++)
         {
-            fprintf(fp, "CONNECTION %d: %s\n", j + 1, roomList[i].outboundConnections[j]->name);
+            fprintf(fp, "CONNECTION %d: %s\n", j + 1,
+                pool->arena + roomList[i].outboundConnections[j]->name);
         }
 
         // Write room type to output file
@@ -279,6 +489,92 @@ void WriteRoomFiles(Room roomList[], int listSize)
     }
 }
 
+// Writes a string to a C source file as the body of a string literal
+// Quotes, backslashes and unprintable bytes are escaped; octal escapes
+// always use 3 digits so they can't run into the following text
+void WriteCString(FILE* fp, const char* str)
+{
+    for (; *str != '\0'; str++)
+    {
+        if (*str == '"' || *str == '\\')
+            fprintf(fp, "\\%c", *str);
+        else if (*str == '\n')
+            fprintf(fp, "\\n");
+        else if (isprint((unsigned char)*str) && *str != '?')
+            fputc(*str, fp);
+        else
+            fprintf(fp, "\\%03o", (unsigned char)*str);
+    }
+}
+
+// Writes a C header describing the dungeon as static const tables, for
+// compiling straight into adventure (see README)
+// The names table and prompts match what adventure would otherwise
+// build at runtime from the room files in dirName
+void WriteDungeonHeader(Room roomList[], int listSize, NamePool* pool, char dirName[])
+{
+    FILE* fp;
+    const char* name;
+    uint32_t nameOffsets[NUM_ROOMS];
+    uint32_t offset = 0;
+    int i;
+    int j;
+
+    fp = fopen(EMBED_FILE, "w");
+
+    fprintf(fp, "/* Generated by buildrooms from %s. Do not edit. */\n\n", dirName);
+    fprintf(fp, "#if NUM_ROOMS != %d\n#error \"%s was generated for %d rooms\"\n#endif\n\n",
+        listSize, EMBED_FILE, listSize);
+    fprintf(fp, "#define EMBEDDED_DUNGEON_ID \"%s\"\n\n", dirName);
+
+    // Room names, back to back in one string table
+    fprintf(fp, "static const char embeddedNames[] =");
+    for (i = 0; i < listSize; i++)
+    {
+        name = pool->arena + roomList[i].name;
+        nameOffsets[i] = offset;
+        offset += strlen(name) + 1;
+
+        fprintf(fp, "\n    \"");
+        WriteCString(fp, name);
+        fprintf(fp, i == listSize - 1 ? "\";\n\n" : "\\0\"");
+    }
+
+    // Rooms, with doors pointing back into the same table
+    fprintf(fp, "static const Room embeddedDungeon[NUM_ROOMS] =\n{\n");
+    for (i = 0; i < listSize; i++)
+    {
+        fprintf(fp, "    { .id = %d, .name = %u, .numDoors = %d, .rt = %s,\n      .doors = {",
+            roomList[i].id, nameOffsets[i], roomList[i].numOutboundConnections,
+            RoomTypeString(roomList[i].rType));
+        for (j = 0; j < roomList[i].numOutboundConnections; j++)
+        {
+            fprintf(fp, "%s&embeddedDungeon[%d]", j == 0 ? " " : ", ",
+                roomList[i].outboundConnections[j]->id);
+        }
+        fprintf(fp, " } },\n");
+    }
+    fprintf(fp, "};\n\n");
+
+    // Full prompt text for each room, as printed by ShowUserPrompt
+    fprintf(fp, "static const char* const embeddedPrompts[NUM_ROOMS] =\n{\n");
+    for (i = 0; i < listSize; i++)
+    {
+        fprintf(fp, "    \"\\nCURRENT LOCATION: ");
+        WriteCString(fp, pool->arena + roomList[i].name);
+        fprintf(fp, "\\n\"\n    \"POSSIBLE CONNECTIONS: ");
+        for (j = 0; j < roomList[i].numOutboundConnections; j++)
+        {
+            WriteCString(fp, pool->arena + roomList[i].outboundConnections[j]->name);
+            fprintf(fp, j == roomList[i].numOutboundConnections - 1 ? ".\\n" : ", ");
+        }
+        fprintf(fp, "\"\n    \"WHERE TO? >\",\n");
+    }
+    fprintf(fp, "};\n");
+
+    fclose(fp);
+}
+
 // Converts a RoomType value to its string equivalent
 char* RoomTypeString(RoomType x)
 {